@@ -1,8 +1,13 @@
 #include <chrono>
+#include <filesystem>
 #include <iostream>
 #include <pbar.hpp>
 #include <thread>
 
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
 void example_pbar(void) {
 	using namespace std::this_thread;
 	using namespace std::chrono;
@@ -21,6 +26,9 @@ void example_pbar(void) {
 	constexpr auto bar2_total = 4;
 	constexpr auto bar3_total = 8;
 
+	pbar::recorder rec;
+	// load it in chrome://tracing or Perfetto
+	rec.dump_on_exit((std::filesystem::temp_directory_path() / "pbar_trace.json").string());
 	pbar::pbar bar1(bar1_total, "[TASK1]");
 	pbar::pbar bar2(bar2_total, "[TASK2]");
 	pbar::pbar bar3(bar3_total, "[TASK3]");
@@ -28,7 +36,12 @@ void example_pbar(void) {
 	bar2.enable_stack();
 	bar3.enable_stack();
 
+	bar1.enable_recording(rec);
+	bar2.enable_recording(rec);
+	bar3.enable_recording(rec);
+
 	bar1.enable_recalc_console_width(10);  // check console width every 10 ticks
+	bar1.enable_sparkline(100ms);		   // show throughput per 100ms interval
 	bar1 << "msg1" << std::endl;		   // to stdout
 	bar1.warn("msg2\n");				   // to stderr
 
@@ -64,9 +77,37 @@ void example_spinner(void) {
 	spin.err();
 }
 
+#ifndef _WIN32
+void example_aggregator(void) {
+	using namespace std::chrono;
+	using namespace std::this_thread;
+	const std::vector<std::uint64_t> worker_totals = {40, 60, 80};
+	pbar::aggregator agg(worker_totals, "[WORKERS]");
+	agg.enable_worker_bars();
+	agg.init();
+	for (std::size_t w = 0; w < worker_totals.size(); ++w) {
+		auto pid = fork();
+		if (pid == 0) {
+			auto rep = agg.make_reporter(w, 4);	 // publish every 4 ticks
+			for (std::uint64_t i = 0; i < worker_totals[w]; ++i, ++rep) {
+				sleep_for(milliseconds(10 * (w + 1)));
+			}
+			rep.done();
+			_exit(0);  // never return or exit() from a worker
+		}
+		agg.set_pid(w, pid);  // reaped by agg, which marks crashed workers as done
+	}
+	agg.wait(50ms);
+	std::cout << "WORKERS done!" << std::endl;
+}
+#endif
+
 int main(void) {
 	example_pbar();
 	example_spinner();
+#ifndef _WIN32
+	example_aggregator();
+#endif
 
 	return 0;
 }
\ No newline at end of file
@@ -1,13 +1,19 @@
 #pragma once
 #include <array>
+#include <atomic>
 #include <chrono>
 #include <cmath>
+#include <fstream>
 #include <iomanip>
 #include <iostream>
+#include <memory>
 #include <mutex>
+#include <numeric>
 #include <optional>
 #include <sstream>
 #include <thread>
+#include <utility>
+#include <vector>
 
 #ifdef _WIN32
 #define NOMINMAX
@@ -20,6 +26,8 @@
 #else
 #define DWORD unsigned long
 #include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
 #include <unistd.h>
 #endif
 
@@ -204,6 +212,128 @@ inline std::optional<int> get_console_width() {
 }
 }  // namespace term
 
+// records progress of bars into a preallocated ring buffer and dumps it in the Chrome
+// trace-event format, which chrome://tracing and Perfetto can load.
+// timestamps are taken from std::chrono::steady_clock. the recorder must outlive the bars.
+class recorder {
+   public:
+	enum class event : std::uint8_t { start, progress, reset, finish };
+
+	explicit recorder(std::size_t capacity = 1 << 16) : samples_(capacity) {
+		if (capacity == 0) throw std::invalid_argument("capacity must be greater than zero");
+	}
+
+	~recorder() {
+		if (dump_path_.empty()) {
+			return;
+		}
+		try {
+			dump(dump_path_);
+		} catch (std::runtime_error& e) {
+			std::cerr << e.what() << std::endl;
+		}
+	}
+
+	recorder(const recorder&) = delete;
+	recorder& operator=(const recorder&) = delete;
+
+	std::uint32_t add_track(const std::string& name) {
+		names_.push_back(name);
+		return static_cast<std::uint32_t>(names_.size() - 1);
+	}
+	void rename_track(std::uint32_t track, const std::string& name) { names_.at(track) = name; }
+
+	// once the buffer is full the oldest samples are overwritten
+	void record(std::uint32_t track, event ev, std::uint64_t value,
+				std::chrono::steady_clock::time_point time) noexcept {
+		samples_[head_] = {
+			std::chrono::duration_cast<std::chrono::nanoseconds>(time.time_since_epoch()).count(),
+			value, track, ev};
+		head_ = head_ + 1 == samples_.size() ? 0 : head_ + 1;
+		if (size_ < samples_.size()) size_++;
+	}
+
+	void clear() {
+		head_ = 0;
+		size_ = 0;
+	}
+
+	// the trace is written to `path` when the recorder is destroyed
+	void dump_on_exit(const std::string& path) { dump_path_ = path; }
+
+	void dump(const std::string& path) const {
+		std::ofstream ofs(path);
+		if (!ofs) {
+			throw std::runtime_error("cannot open " + path);
+		}
+		dump(ofs);
+	}
+
+	void dump(std::ostream& os) const {
+#ifdef _WIN32
+		auto pid = ::GetCurrentProcessId();
+#else
+		auto pid = ::getpid();
+#endif
+		const char* sep = "\n";
+		os << "{\"traceEvents\":[";
+		for (std::uint32_t track = 0; track < names_.size(); track++) {
+			os << sep << R"({"name":"thread_name","ph":"M","pid":)" << pid << R"(,"tid":)" << track
+			   << R"(,"args":{"name":")" << escape(names_[track]) << R"("}})";
+			sep = ",\n";
+		}
+		auto first = size_ < samples_.size() ? 0 : head_;
+		for (std::size_t i = 0; i < size_; i++) {
+			const auto& s = samples_[(first + i) % samples_.size()];
+			os << sep;
+			sep = ",\n";
+			if (s.ev == event::progress) {
+				os << R"({"name":")" << escape(names_[s.track]) << R"(","ph":"C","id":)" << s.track;
+			} else {
+				os << R"({"name":")" << event_names_[static_cast<std::size_t>(s.ev)]
+				   << R"(","ph":"i","s":"t")";
+			}
+			// microseconds with nanosecond resolution
+			auto frac = s.ns % 1000;
+			os << R"(,"ts":)" << s.ns / 1000 << '.' << (frac < 100 ? "0" : "")
+			   << (frac < 10 ? "0" : "") << frac << R"(,"pid":)" << pid << R"(,"tid":)" << s.track
+			   << R"(,"args":{"progress":)" << s.value << "}}";
+		}
+		os << "\n]}\n";
+	}
+
+   private:
+	struct sample {
+		std::int64_t ns;
+		std::uint64_t value;
+		std::uint32_t track;
+		event ev;
+	};
+
+	static std::string escape(const std::string& str) {
+		std::ostringstream oss;
+		for (char c : str) {
+			if (c == '"' || c == '\\') {
+				oss << '\\' << c;
+			} else if (static_cast<unsigned char>(c) < 0x20) {
+				oss << "\\u" << std::hex << std::setw(4) << std::setfill('0')
+					<< static_cast<int>(c);
+			} else {
+				oss << c;
+			}
+		}
+		return oss.str();
+	}
+
+	inline static const std::array<std::string, 4> event_names_ = {
+		{"start", "progress", "reset", "finish"}};
+	std::vector<sample> samples_;
+	std::size_t head_ = 0;
+	std::size_t size_ = 0;
+	std::vector<std::string> names_;
+	std::string dump_path_;
+};
+
 class pbar {
    public:
 	pbar(std::uint64_t total, const std::string& desc = "")
@@ -234,23 +364,39 @@ class pbar {
 
 	void tick(std::uint64_t delta = 1) {
 		using namespace std::chrono;
-		if (term::equal_stdout_term() == 0) {
+		bool is_term = term::equal_stdout_term();
+		if (!is_term && !recorder_) {
 			return;
 		}
+		bool starting = !progress_.has_value();
+		std::uint64_t prog = std::min(progress_.value_or(0) + delta, total_);
+		progress_ = prog;
 
-		if (!progress_.has_value() && enable_stack_) {
-			u8cout_ << std::endl;
+		steady_clock::time_point now;
+		if ((enable_time_measurement_ && is_term) || recorder_) {
+			now = steady_clock::now();
+		}
+		if (recorder_) {
+			if (starting) recorder_->record(track_, recorder::event::start, prog, now);
+			recorder_->record(track_, recorder::event::progress, prog, now);
+		}
+
+		// recording bars keep tracking progress without a terminal; only drawing is skipped
+		if (!is_term) {
+			if (prog == total_) {
+				if (recorder_) recorder_->record(track_, recorder::event::finish, prog, now);
+				reset_state();
+			}
+			return;
 		}
 
-		if (!progress_.has_value()) {
-			progress_ = 0;
+		if (starting) {
+			if (enable_stack_) {
+				u8cout_ << std::endl;
+			}
 			ncols_ = std::min(static_cast<std::uint64_t>(term::get_console_width().value_or(1) - 1),
 							  ncols_);
 		}
-		std::uint64_t prog = progress_.value();
-		prog += delta;
-		prog = std::min(prog, total_);
-		progress_ = prog;
 
 		if (recalc_cycle_ && (prog % recalc_cycle_.value()) == 0) {
 			ncols_ = std::min(static_cast<std::uint64_t>(term::get_console_width().value_or(1) - 1),
@@ -263,14 +409,17 @@ class pbar {
 
 		if (enable_time_measurement_) {
 			if (!epoch_) {
-				epoch_ = steady_clock::now();
+				epoch_ = now;
 			} else {
-				dt = steady_clock::now() - *epoch_;
+				dt = now - *epoch_;
 			}
 			if (dt.count() > 0) {
 				vel = static_cast<double>(prog) / (dt.count() * 1e-9);
 				remaining = seconds(static_cast<long long>(std::round((total_ - prog) / (vel))));
 			}
+			if (sparkline_interval_) {
+				sample_sparkline(now, prog);
+			}
 		}
 		std::int64_t width_non_brackets_base = desc_.size() + 2 * digit_ + 8;
 		std::int64_t width_non_brackets_time = 0;
@@ -282,6 +431,9 @@ class pbar {
 			if (auto remain_h = duration_cast<hours>(remaining).count(); remain_h > 0) {
 				width_non_brackets_time += 1 + utils::get_digit(remain_h);
 			}
+			if (sparkline_interval_) {
+				width_non_brackets_time += 1 + sparkline_size_;
+			}
 		}
 		std::uint64_t width_non_brackets = width_non_brackets_base + width_non_brackets_time;
 		std::uint64_t width_brackets;
@@ -325,6 +477,10 @@ class pbar {
 			u8cout_ << std::setw(2) << duration_cast<minutes>(remaining).count() % 60 << ':'
 					<< std::setw(2) << remaining.count() % 60 << ", " << std::setw(0) << std::fixed
 					<< std::setprecision(2) << vel << "it/s]";
+			if (sparkline_interval_) {
+				u8cout_ << ' ';
+				print_sparkline();
+			}
 		}
 		if (progress_ == total_) {
 			if (!leave_) {
@@ -335,21 +491,30 @@ class pbar {
 			if (enable_stack_ && !interrupted_) {
 				u8cout_ << term::up(1);
 			}
-			reset();
+			if (recorder_) recorder_->record(track_, recorder::event::finish, prog, now);
+			reset_state();
 		}
 		u8cout_ << std::setfill(prev);
 		u8cout_.flush();
 	}
 
 	// we assume desc_ consists of ascii characters
-	void set_description(const std::string& desc) { desc_ = desc; }
-	void set_description(std::string&& desc) { desc_ = std::move(desc); }
+	void set_description(const std::string& desc) {
+		desc_ = desc;
+		rename_track();
+	}
+	void set_description(std::string&& desc) {
+		desc_ = std::move(desc);
+		rename_track();
+	}
 #if __cplusplus > 201703L  // for C++20
 	void set_description(const std::u8string& desc) {
 		desc_ = reinterpret_cast<const char*>(desc.data());
+		rename_track();
 	}
 	void set_description(std::u8string&& desc) {
 		desc_ = reinterpret_cast<const char*>(std::move(desc.data()));
+		rename_track();
 	}
 #endif
 	void enable_stack() {
@@ -367,11 +532,28 @@ class pbar {
 		recalc_cycle_ = cycle;
 	}
 	void disable_recalc_console_width() { recalc_cycle_ = std::nullopt; }
+	// shows throughput of the last `sparkline_size_` intervals. requires time measurement
+	void enable_sparkline(std::chrono::milliseconds interval = std::chrono::milliseconds(1000)) {
+		if (interval.count() <= 0) {
+			throw std::invalid_argument("interval must be greater than zero");
+		}
+		sparkline_interval_ = interval;
+		reset_sparkline();
+	}
+	void disable_sparkline() { sparkline_interval_ = std::nullopt; }
+	// records start, progress, reset and finish events of this bar into `rec`
+	void enable_recording(recorder& rec) {
+		recorder_ = &rec;
+		track_ = rec.add_track(desc_.empty() ? "pbar" : desc_);
+	}
+	void disable_recording() { recorder_ = nullptr; }
 
 	void reset() {
-		progress_ = std::nullopt;
-		epoch_ = std::nullopt;
-		interrupted_ = false;
+		if (recorder_ && progress_) {
+			recorder_->record(track_, recorder::event::reset, *progress_,
+							  std::chrono::steady_clock::now());
+		}
+		reset_state();
 	}
 
 	void init() { tick(0); }
@@ -421,6 +603,7 @@ class pbar {
 		leave_ = other.leave_;
 		enable_time_measurement_ = other.enable_time_measurement_;
 		interrupted_ = other.interrupted_;
+		sparkline_interval_ = other.sparkline_interval_;
 		return *this;
 	}
 	pbar& operator=(pbar&& other) noexcept {
@@ -432,10 +615,77 @@ class pbar {
 		leave_ = std::move(other.leave_);
 		enable_time_measurement_ = std::move(other.enable_time_measurement_);
 		interrupted_ = std::move(other.interrupted_);
+		sparkline_interval_ = std::move(other.sparkline_interval_);
 		return *this;
 	}
 
    private:
+	void reset_state() {
+		progress_ = std::nullopt;
+		epoch_ = std::nullopt;
+		interrupted_ = false;
+		reset_sparkline();
+	}
+
+	void reset_sparkline() {
+		sparkline_counts_.fill(0);
+		sparkline_head_ = 0;
+		sparkline_mark_ = std::nullopt;
+	}
+
+	void rename_track() {
+		if (recorder_) recorder_->rename_track(track_, desc_.empty() ? "pbar" : desc_);
+	}
+
+	// sampled only when the bar is rendered. when intervals have closed since the previous render,
+	// the open one gets the progress up to that render, the rest are recorded as stalls and the
+	// current tick opens the new interval
+	void sample_sparkline(std::chrono::steady_clock::time_point now, std::uint64_t prog) {
+		if (!sparkline_mark_) {
+			sparkline_mark_ = now;
+			sparkline_mark_prog_ = prog;
+			sparkline_prev_prog_ = prog;
+			return;
+		}
+		auto elapsed = (now - *sparkline_mark_) / *sparkline_interval_;
+		if (elapsed > 0) {
+			push_sparkline(sparkline_prev_prog_ - sparkline_mark_prog_);
+			auto stalls = std::min<decltype(elapsed)>(elapsed - 1, sparkline_size_);
+			for (decltype(stalls) _ = 0; _ < stalls; _++) {
+				push_sparkline(0);
+			}
+			*sparkline_mark_ += elapsed * *sparkline_interval_;
+			sparkline_mark_prog_ = sparkline_prev_prog_;
+		}
+		sparkline_prev_prog_ = prog;
+	}
+
+	void push_sparkline(std::uint64_t count) {
+		sparkline_counts_[sparkline_head_] = count;
+		sparkline_head_ = (sparkline_head_ + 1) % sparkline_size_;
+	}
+
+	// from oldest to newest. intervals without progress are drawn as spaces
+	void print_sparkline() {
+		std::uint64_t max_count = 0;
+		for (auto count : sparkline_counts_) {
+			max_count = std::max(max_count, count);
+		}
+		for (std::size_t i = 0; i < sparkline_size_; i++) {
+			auto count = sparkline_counts_[(sparkline_head_ + i) % sparkline_size_];
+			if (count == 0) {
+				u8cout_ << ' ';
+				continue;
+			}
+			auto level = (count * sparkline_chars_.size() + max_count - 1) / max_count;
+#if __cplusplus > 201703L  // for C++20
+			u8cout_ << reinterpret_cast<const char*>(sparkline_chars_[level - 1].data());
+#else
+			u8cout_ << sparkline_chars_[level - 1];
+#endif
+		}
+	}
+
 	std::uint64_t total_ = 0;
 	std::uint64_t ncols_ = 80;
 	std::optional<std::uint64_t> progress_ = std::nullopt;
@@ -456,6 +706,22 @@ class pbar {
 	bool leave_ = true;
 	bool enable_time_measurement_ = true;
 	bool interrupted_ = false;
+#if __cplusplus > 201703L  // for C++20
+	inline static const std::array<std::u8string, 8> sparkline_chars_ = {
+#else
+	inline static const std::array<std::string, 8> sparkline_chars_ = {
+#endif
+		{u8"▁", u8"▂", u8"▃", u8"▄", u8"▅", u8"▆", u8"▇", u8"█"}
+	};
+	inline constexpr static std::size_t sparkline_size_ = 16;
+	std::optional<std::chrono::nanoseconds> sparkline_interval_ = std::nullopt;
+	std::array<std::uint64_t, sparkline_size_> sparkline_counts_{};
+	std::size_t sparkline_head_ = 0;
+	std::optional<std::chrono::steady_clock::time_point> sparkline_mark_ = std::nullopt;
+	std::uint64_t sparkline_mark_prog_ = 0;
+	std::uint64_t sparkline_prev_prog_ = 0;
+	recorder* recorder_ = nullptr;
+	std::uint32_t track_ = 0;
 	detail::u8cout_ u8cout_;
 	DWORD dwMode_orig_ = 0;
 };
@@ -633,4 +899,233 @@ class spinner {
 	DWORD dwMode_orig_ = 0;
 };
 
+#ifndef _WIN32
+// combines progress reported by forked worker processes into one bar.
+// the counters live in a shared anonymous mapping, so the aggregator must be constructed before
+// fork(). workers report without any syscalls and only the parent process writes to the terminal;
+// workers must leave with _exit() so that their copy of the aggregator does not touch the terminal.
+class aggregator {
+	struct alignas(64) slot {
+		std::atomic<std::uint64_t> count{0};
+		std::atomic<bool> done{false};
+	};
+	static_assert(std::atomic<std::uint64_t>::is_always_lock_free,
+				  "counters shared between processes must be lock-free");
+
+   public:
+	// used in a worker process. increments are accumulated locally and published every `batch`
+	// ticks; call done() (or mark_done() in the parent) when the worker finishes.
+	class reporter {
+	   public:
+		reporter(const reporter&) = delete;
+		reporter& operator=(const reporter&) = delete;
+		reporter(reporter&& other) noexcept
+			: slot_(std::exchange(other.slot_, nullptr)),
+			  batch_(other.batch_),
+			  pending_(std::exchange(other.pending_, 0)) {}
+		~reporter() { flush(); }
+
+		void tick(std::uint64_t delta = 1) {
+			pending_ += delta;
+			if (pending_ >= batch_) flush();
+		}
+		void flush() {
+			if (!slot_ || pending_ == 0) return;
+			slot_->count.fetch_add(pending_, std::memory_order_relaxed);
+			pending_ = 0;
+		}
+		void done() {
+			if (!slot_) return;
+			flush();
+			slot_->done.store(true, std::memory_order_release);
+		}
+		reporter& operator+=(std::uint64_t delta) {
+			tick(delta);
+			return *this;
+		}
+		reporter& operator++(void) {
+			tick(1);
+			return *this;
+		}
+		reporter& operator++(int) {
+			tick(1);
+			return *this;
+		}
+
+	   private:
+		friend class aggregator;
+		reporter(slot* s, std::uint64_t batch) : slot_(s), batch_(batch) {}
+
+		slot* slot_;
+		std::uint64_t batch_;
+		std::uint64_t pending_ = 0;
+	};
+
+	aggregator(std::uint64_t total, std::size_t nworkers, const std::string& desc = "")
+		: total_(total),
+		  nworkers_(nworkers),
+		  desc_(desc),
+		  bar_(total, desc),
+		  last_(nworkers, 0),
+		  deltas_(nworkers, 0),
+		  pids_(nworkers, 0) {
+		if (nworkers_ == 0) throw std::invalid_argument("nworkers must be greater than zero");
+		void* p = mmap(nullptr, sizeof(slot) * nworkers_, PROT_READ | PROT_WRITE,
+					   MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+		if (p == MAP_FAILED) {
+			throw std::runtime_error("mmap failed. cannot create shared counters.");
+		}
+		slots_ = static_cast<slot*>(p);
+		for (std::size_t i = 0; i < nworkers_; i++) {
+			new (&slots_[i]) slot();
+		}
+	}
+
+	aggregator(const std::vector<std::uint64_t>& worker_totals, const std::string& desc = "")
+		: aggregator(std::accumulate(worker_totals.begin(), worker_totals.end(), std::uint64_t{0}),
+					 worker_totals.size(), desc) {
+		for (auto worker_total : worker_totals) {
+			if (worker_total == 0) {
+				throw std::invalid_argument("worker totals must be greater than zero");
+			}
+		}
+		worker_totals_ = worker_totals;
+	}
+
+	aggregator(const aggregator&) = delete;
+	aggregator& operator=(const aggregator&) = delete;
+
+	~aggregator() { munmap(slots_, sizeof(slot) * nworkers_); }
+
+	// can be called either before or after fork()
+	reporter make_reporter(std::size_t worker, std::uint64_t batch = 1) {
+		if (worker >= nworkers_) {
+			throw std::invalid_argument("worker must be less than nworkers");
+		}
+		if (batch == 0) {
+			throw std::invalid_argument("batch must be greater than zero");
+		}
+		return reporter(&slots_[worker], batch);
+	}
+
+	// shows a bar per worker above the combined one. requires per-worker totals
+	void enable_worker_bars() {
+		if (worker_totals_.empty()) {
+			throw std::runtime_error("worker totals are unknown");
+		}
+		if (started_) {
+			throw std::runtime_error("worker bars must be enabled before init");
+		}
+		worker_bars_.clear();
+		for (std::size_t i = 0; i < nworkers_; i++) {
+			worker_bars_.push_back(
+				std::make_unique<pbar>(worker_totals_[i], desc_ + "#" + std::to_string(i)));
+		}
+		worker_finished_.assign(nworkers_, false);
+	}
+
+	// for workers that exited without calling reporter::done()
+	void mark_done(std::size_t worker) {
+		if (worker >= nworkers_) {
+			throw std::invalid_argument("worker must be less than nworkers");
+		}
+		slots_[worker].done.store(true, std::memory_order_release);
+	}
+
+	// update() reaps the worker with waitpid() and marks it done once it exits,
+	// even if it crashed or never called reporter::done()
+	void set_pid(std::size_t worker, pid_t pid) {
+		if (worker >= nworkers_) {
+			throw std::invalid_argument("worker must be less than nworkers");
+		}
+		pids_[worker] = pid;
+	}
+
+	void init() { update(); }
+
+	// polls the shared counters and redraws the bars.
+	// returns true once every worker is done or the total is reached, and every worker registered
+	// with set_pid() has been reaped.
+	bool update() {
+		if (finished_) return true;
+		bool all_reaped = true;
+		for (std::size_t i = 0; i < nworkers_; i++) {
+			if (pids_[i] > 0 && waitpid(pids_[i], nullptr, WNOHANG) != 0) {
+				pids_[i] = 0;
+				mark_done(i);
+			}
+			all_reaped = pids_[i] <= 0 && all_reaped;
+		}
+		if (!completed_) {
+			poll_counters();
+		}
+		finished_ = completed_ && all_reaped;
+		return finished_;
+	}
+
+	// without set_pid(), a worker that exits without calling reporter::done() blocks forever
+	void wait(std::chrono::milliseconds interval = std::chrono::milliseconds(100)) {
+		while (!update()) {
+			std::this_thread::sleep_for(interval);
+		}
+	}
+
+   private:
+	void poll_counters() {
+		std::uint64_t delta = 0;
+		bool all_done = true;
+		for (std::size_t i = 0; i < nworkers_; i++) {
+			// load the flag first so that the last flush before done() is never missed
+			all_done = slots_[i].done.load(std::memory_order_acquire) && all_done;
+			auto count = slots_[i].count.load(std::memory_order_relaxed);
+			deltas_[i] = count - last_[i];
+			last_[i] = count;
+			delta += deltas_[i];
+		}
+		progress_ += delta;
+		completed_ = all_done || progress_ >= total_;
+		render(delta);
+	}
+
+	void render(std::uint64_t delta) {
+		if (!term::equal_stdout_term()) return;
+		if (!worker_bars_.empty()) {
+			if (started_) u8cout_ << '\r' << term::up(static_cast<short>(nworkers_));
+			for (std::size_t i = 0; i < nworkers_; i++) {
+				if (!worker_finished_[i]) {
+					worker_bars_[i]->tick(deltas_[i]);
+					worker_finished_[i] = last_[i] >= worker_totals_[i];
+					// a finished bar has already moved the cursor to the next line
+					if (worker_finished_[i]) continue;
+				}
+				u8cout_ << '\n';
+			}
+		}
+		started_ = true;
+		bar_.tick(delta);
+		if (completed_ && progress_ < total_) {
+			u8cout_ << std::endl;
+		}
+		u8cout_.flush();
+	}
+
+	std::uint64_t total_;
+	std::size_t nworkers_;
+	std::string desc_;
+	pbar bar_;
+	std::uint64_t progress_ = 0;
+	std::vector<std::uint64_t> worker_totals_;
+	std::vector<std::uint64_t> last_;
+	std::vector<std::uint64_t> deltas_;
+	std::vector<std::unique_ptr<pbar>> worker_bars_;
+	std::vector<bool> worker_finished_;
+	std::vector<pid_t> pids_;
+	slot* slots_ = nullptr;
+	bool started_ = false;
+	bool completed_ = false;
+	bool finished_ = false;
+	detail::u8cout_ u8cout_;
+};
+#endif
+
 }  // namespace pbar